@@ -0,0 +1,196 @@
+#include "artifacts.h"
+#include "util.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <mutex>
+#include <system_error>
+#include <vector>
+#include <cstdint>
+#include <openssl/sha.h>
+
+const std::string store_path = "/home/willi/bin/hildabot/artifacts";
+constexpr size_t max_artifacts = 5;
+constexpr uint64_t max_store_size = 1024ULL * 1024 * 1024;
+// Deploy order, oldest first, one digest per line. Kept apart from the mtimes, which only track use for eviction
+const std::string history_path = store_path + "/history";
+constexpr size_t max_history = 64;
+
+// Deploys and rollbacks run on their own threads
+static std::mutex store_mutex;
+
+struct artifact_entry {
+    std::filesystem::path path;
+    uint64_t size;
+    std::filesystem::file_time_type last_used;
+};
+
+static bool is_digest(const std::string& value) {
+    return value.size() == SHA256_DIGEST_LENGTH * 2 && std::all_of(value.begin(), value.end(), [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+    });
+}
+
+// Most recently used first; the file mtime doubles as the LRU timestamp
+static std::vector<artifact_entry> list_artifacts() {
+    std::vector<artifact_entry> entries;
+    std::error_code ec;
+
+    for (const auto& file : std::filesystem::directory_iterator(store_path, ec)) {
+        if (!file.is_regular_file(ec) || !is_digest(file.path().filename().string())) {
+            continue;
+        }
+
+        const uint64_t size = file.file_size(ec);
+        if (ec) {
+            continue;
+        }
+
+        const std::filesystem::file_time_type last_used = file.last_write_time(ec);
+        if (ec) {
+            continue;
+        }
+
+        entries.push_back({ file.path(), size, last_used });
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const artifact_entry& a, const artifact_entry& b) {
+        return a.last_used > b.last_used;
+    });
+
+    return entries;
+}
+
+static std::vector<std::string> read_history() {
+    std::vector<std::string> history;
+    std::ifstream file(history_path);
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (is_digest(line)) {
+            history.push_back(line);
+        }
+    }
+
+    return history;
+}
+
+static bool append_history(const std::string& digest) {
+    std::vector<std::string> history = read_history();
+    history.push_back(digest);
+    if (history.size() > max_history) {
+        history.erase(history.begin(), history.end() - max_history);
+    }
+
+    const std::string partial = history_path + ".partial";
+    std::ofstream file(partial, std::ios::trunc | std::ios::out);
+    for (const std::string& entry : history) {
+        file << entry << '\n';
+    }
+    file.close();
+
+    std::error_code ec;
+    if (!file) {
+        std::filesystem::remove(partial, ec);
+        return false;
+    }
+
+    std::filesystem::rename(partial, history_path, ec);
+    return !ec;
+}
+
+bool deploy::retain_artifact(const std::string& path) {
+    std::optional<std::string> digest = util::sha256_file(path);
+    if (!digest) {
+        return false;
+    }
+
+    const std::filesystem::path target = std::filesystem::path(store_path) / *digest;
+    std::lock_guard<std::mutex> lock(store_mutex);
+    std::error_code ec;
+
+    std::filesystem::create_directories(store_path, ec);
+    if (ec) {
+        return false;
+    }
+
+    if (!std::filesystem::exists(target, ec)) {
+        // Write under a non-digest name and rename, so a partial file is never picked up as an artifact
+        const std::filesystem::path partial = target.string() + ".partial";
+        std::filesystem::copy_file(path, partial, std::filesystem::copy_options::overwrite_existing, ec);
+        if (ec) {
+            std::filesystem::remove(partial, ec);
+            return false;
+        }
+
+        std::filesystem::rename(partial, target, ec);
+        if (ec) {
+            std::filesystem::remove(partial, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::last_write_time(target, std::filesystem::file_time_type::clock::now(), ec);
+    if (!append_history(*digest)) {
+        std::cout << "Failed to record deploy history\n";
+    }
+
+    // The newest artifact is always kept, even if it alone is over the size budget
+    std::vector<artifact_entry> entries = list_artifacts();
+    uint64_t total_size = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i > 0 && (kept >= max_artifacts || total_size + entries[i].size > max_store_size)) {
+            std::cout << "Evicting artifact " << entries[i].path.filename().string() << '\n';
+            std::filesystem::remove(entries[i].path, ec);
+            continue;
+        }
+
+        total_size += entries[i].size;
+        kept++;
+    }
+
+    return true;
+}
+
+std::optional<std::string> deploy::find_artifact(const std::string& digest) {
+    if (!is_digest(digest)) {
+        return std::nullopt;
+    }
+
+    const std::filesystem::path target = std::filesystem::path(store_path) / digest;
+    std::lock_guard<std::mutex> lock(store_mutex);
+    std::error_code ec;
+
+    if (!std::filesystem::is_regular_file(target, ec)) {
+        return std::nullopt;
+    }
+
+    // Rollbacks skip attestation on the strength of the name, so make sure the contents still match it
+    if (util::sha256_file(target.string()) != digest) {
+        std::cout << "Removing corrupt artifact " << digest << '\n';
+        std::filesystem::remove(target, ec);
+        return std::nullopt;
+    }
+
+    std::filesystem::last_write_time(target, std::filesystem::file_time_type::clock::now(), ec);
+    return target.string();
+}
+
+std::optional<std::string> deploy::previous_artifact(const std::string& installed) {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    std::vector<std::string> history = read_history();
+
+    // Walk back from the latest deploy of the installed binary (or from the newest deploy, if it was never
+    // recorded), so repeated rollbacks keep going further back instead of flipping between two versions
+    auto start = std::find(history.rbegin(), history.rend(), installed);
+    for (auto it = start == history.rend() ? history.rbegin() : start; it != history.rend(); it++) {
+        std::error_code ec;
+        if (*it != installed && std::filesystem::is_regular_file(std::filesystem::path(store_path) / *it, ec)) {
+            return *it;
+        }
+    }
+
+    return std::nullopt;
+}
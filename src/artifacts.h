@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+#include <optional>
+
+namespace deploy {
+    // Copies a freshly deployed, already-verified binary into the store under its SHA-256 and records it
+    // in the deploy history, then evicts the least recently used artifacts until the store is back within
+    // its count and size budget
+    bool retain_artifact(const std::string& path);
+    // Path of a retained artifact whose contents still match its digest, marking it as most recently used
+    // (for eviction only; it doesn't change the deploy history)
+    std::optional<std::string> find_artifact(const std::string& digest);
+    // Digest of the retained artifact deployed before `installed`, going by deploy history rather than use.
+    // Rolling back to it and asking again therefore steps one deploy further back each time
+    std::optional<std::string> previous_artifact(const std::string& installed);
+}
@@ -0,0 +1,163 @@
+#include "decompress.h"
+#include <stdexcept>
+#include <cctype>
+#include <algorithm>
+#include <bit>
+
+std::optional<server::content_encoding> server::parse_content_encoding(const std::string& value) {
+    std::string encoding;
+    for (char c : value) {
+        if (c != ' ' && c != '\t') {
+            encoding += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+    }
+
+    if (encoding.empty() || encoding == "identity") {
+        return content_encoding::IDENTITY;
+    }
+    else if (encoding == "gzip" || encoding == "x-gzip") {
+        return content_encoding::GZIP;
+    }
+    else if (encoding == "zstd") {
+        return content_encoding::ZSTD;
+    }
+
+    return std::nullopt;
+}
+
+server::decompressor::decompressor(content_encoding encoding, uint64_t max_output_size) : encoding(encoding), max_output_size(max_output_size) {
+    constexpr size_t chunk_size = 64 * 1024;
+
+    switch (encoding) {
+        case content_encoding::IDENTITY:
+            // Nothing to decode; an empty body is a complete stream
+            this->finished = true;
+            break;
+        case content_encoding::GZIP:
+            this->gzip_stream = std::make_unique<z_stream>();
+            // 15 window bits + 16 to only accept a gzip wrapper
+            if (inflateInit2(this->gzip_stream.get(), 15 + 16) != Z_OK) {
+                this->gzip_stream.reset();
+                throw std::runtime_error("Failed to initialize gzip stream");
+            }
+            this->out_buffer.resize(chunk_size);
+            break;
+        case content_encoding::ZSTD:
+            this->zstd_ctx.reset(ZSTD_createDCtx());
+            if (!this->zstd_ctx) {
+                throw std::runtime_error("Failed to initialize zstd stream");
+            }
+            this->set_window_limit(max_output_size);
+            this->out_buffer.resize(chunk_size);
+            break;
+    }
+}
+
+server::decompressor::~decompressor() {
+    if (this->gzip_stream) {
+        inflateEnd(this->gzip_stream.get());
+    }
+}
+
+void server::decompressor::set_prefix(const std::vector<uint8_t>& prefix) {
+    if (this->encoding != content_encoding::ZSTD) {
+        throw std::logic_error("Prefixes are only supported for zstd streams");
+    }
+
+    // --patch-from sizes the window to cover the larger of the base and the output
+    this->set_window_limit(std::max<uint64_t>(prefix.size(), this->max_output_size));
+
+    size_t ret = ZSTD_DCtx_refPrefix(this->zstd_ctx.get(), prefix.data(), prefix.size());
+    if (ZSTD_isError(ret)) {
+        throw std::runtime_error(std::string("Failed to set zstd prefix: ") + ZSTD_getErrorName(ret));
+    }
+}
+
+void server::decompressor::set_window_limit(uint64_t window_size) {
+    // Frames made with --long (or --patch-from) can need a window past zstd's default 128 MiB limit; allow
+    // enough to cover window_size and no more, so the cap also bounds how much the decoder allocates
+    constexpr int default_window_log = 27; // ZSTD_WINDOWLOG_LIMIT_DEFAULT, which is only in the static API
+    const int window_log = std::max(default_window_log, static_cast<int>(std::bit_width(window_size)));
+
+    size_t ret = ZSTD_DCtx_setParameter(this->zstd_ctx.get(), ZSTD_d_windowLogMax, window_log);
+    if (ZSTD_isError(ret)) {
+        throw std::runtime_error(std::string("Failed to set zstd window limit: ") + ZSTD_getErrorName(ret));
+    }
+}
+
+void server::decompressor::emit(const uint8_t* data, size_t size, const sink& out) {
+    if (size == 0) {
+        return;
+    }
+
+    this->produced += size;
+    if (this->produced > this->max_output_size) {
+        throw std::length_error("Decompressed size limit exceeded");
+    }
+
+    out(data, size);
+}
+
+void server::decompressor::update(const uint8_t* data, size_t size, const sink& out) {
+    if (size == 0) {
+        return;
+    }
+
+    if (this->encoding == content_encoding::IDENTITY) {
+        this->emit(data, size, out);
+        return;
+    }
+
+    if (this->encoding == content_encoding::GZIP) {
+        z_stream* stream = this->gzip_stream.get();
+        stream->next_in = const_cast<Bytef*>(data);
+        stream->avail_in = static_cast<uInt>(size);
+
+        // Keep going while there's input left or inflate filled the whole buffer (it may have more pending)
+        do {
+            // Input after the end of a member is the start of the next one (RFC 1952 allows concatenation)
+            if (this->finished) {
+                if (inflateReset(stream) != Z_OK) {
+                    throw std::runtime_error("Failed to reset gzip stream");
+                }
+                this->finished = false;
+            }
+
+            stream->next_out = this->out_buffer.data();
+            stream->avail_out = static_cast<uInt>(this->out_buffer.size());
+
+            int ret = inflate(stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                this->finished = true;
+            }
+            else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                throw std::runtime_error("Malformed gzip stream");
+            }
+
+            this->emit(this->out_buffer.data(), this->out_buffer.size() - stream->avail_out, out);
+        } while (stream->avail_in > 0 || (!this->finished && stream->avail_out == 0));
+
+        return;
+    }
+
+    ZSTD_inBuffer input{data, size, 0};
+    ZSTD_outBuffer output;
+    do {
+        output = ZSTD_outBuffer{this->out_buffer.data(), this->out_buffer.size(), 0};
+
+        size_t ret = ZSTD_decompressStream(this->zstd_ctx.get(), &output, &input);
+        if (ZSTD_isError(ret)) {
+            throw std::runtime_error(std::string("Malformed zstd stream: ") + ZSTD_getErrorName(ret));
+        }
+
+        // 0 means the current frame is complete; a following frame resets this
+        this->finished = ret == 0;
+        this->emit(this->out_buffer.data(), output.pos, out);
+    } while (input.pos < input.size || output.pos == output.size);
+}
+
+void server::decompressor::finish() const {
+    if (!this->finished) {
+        throw std::runtime_error("Truncated compressed stream");
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <zlib.h>
+#include <zstd.h>
+
+namespace server {
+    enum class content_encoding {
+        IDENTITY,
+        GZIP,
+        ZSTD
+    };
+
+    // Returns std::nullopt for encodings we don't support (including stacked ones like "gzip, zstd")
+    std::optional<content_encoding> parse_content_encoding(const std::string& value);
+
+    // Incremental decoder for a single encoded stream. Output is handed to the sink in chunks as it
+    // is produced, so callers never need the whole decoded payload in memory.
+    // Throws std::length_error once more than max_output_size bytes have been produced, and
+    // std::runtime_error if the stream is malformed.
+    class decompressor {
+        public:
+            using sink = std::function<void(const uint8_t* data, size_t size)>;
+        private:
+            content_encoding encoding;
+            uint64_t max_output_size;
+            uint64_t produced = 0;
+            bool finished = false;
+            std::unique_ptr<z_stream> gzip_stream;
+            std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> zstd_ctx{nullptr, &ZSTD_freeDCtx};
+            std::vector<uint8_t> out_buffer;
+
+            void emit(const uint8_t* data, size_t size, const sink& out);
+            void set_window_limit(uint64_t window_size);
+        public:
+            decompressor(content_encoding encoding, uint64_t max_output_size);
+            decompressor(const decompressor&) = delete;
+            decompressor& operator=(const decompressor&) = delete;
+            ~decompressor();
+
+            // Decode a zstd stream made with --patch-from against `prefix`, which must outlive the decoder
+            void set_prefix(const std::vector<uint8_t>& prefix);
+            void update(const uint8_t* data, size_t size, const sink& out);
+            // Throws if the encoded stream was truncated
+            void finish() const;
+    };
+}
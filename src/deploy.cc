@@ -6,12 +6,70 @@
 #include <iostream>
 #include <cstdlib>
 #include <filesystem>
+#include <optional>
+#include <vector>
+#include <cctype>
+#include <mutex>
+#include <system_error>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include "response.h"
+#include "decompress.h"
+#include "artifacts.h"
+#include "util.h"
 #include "config.h"
 
+// Upper bound on the decoded binary, so a small compressed payload can't fill the disk
+constexpr uint64_t max_payload_size = 256ULL * 1024 * 1024;
+const std::string install_path = "/home/willi/bin/hildabot/hildabot";
+
+static const server::multipart_element* find_element(const server::request& req, const std::string& name) {
+    auto it = std::find_if(
+        req.multipart_body->elements.begin(),
+        req.multipart_body->elements.end(),
+        [&name](const server::multipart_element& elem) {
+            return elem.name == name;
+        }
+    );
+
+    return it == req.multipart_body->elements.end() ? nullptr : &*it;
+}
+
+// Clients may send digests with trailing newlines or in uppercase
+static std::string normalize_digest(const std::vector<uint8_t>& data) {
+    std::string digest;
+    for (uint8_t c : data) {
+        if (!std::isspace(c)) {
+            digest += static_cast<char>(std::tolower(c));
+        }
+    }
+
+    return digest;
+}
+
+// Deploys and rollbacks run on their own threads; held from choosing what to install until it's in place
+static std::mutex install_mutex;
+
+// Swaps a binary into place; the caller is responsible for it having been verified and for holding install_mutex
+static bool install(const std::string& source) {
+    std::system("/usr/bin/sudo /usr/bin/systemctl stop hildabot.service");
+    // EXDEV with rename, so copy
+    std::error_code ec;
+    std::filesystem::copy(source, install_path, std::filesystem::copy_options::overwrite_existing, ec);
+    if (!ec) {
+        chmod(install_path.c_str(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+    }
+    std::system("/usr/bin/sudo /usr/bin/systemctl start hildabot.service");
+
+    if (ec) {
+        std::cout << "Failed to install " << source << ": " << ec.message() << '\n';
+        return false;
+    }
+
+    return true;
+}
+
 void deploy::verify_and_deploy(server::request& req) {
     if (req.method != server::http_method::POST) {
         std::cout << "Invalid method\n";
@@ -35,21 +93,56 @@ void deploy::verify_and_deploy(server::request& req) {
         return;
     }
 
-    auto payload = std::find_if(
-        req.multipart_body->elements.begin(),
-        req.multipart_body->elements.end(),
-        [](const server::multipart_element& elem) {
-            return elem.name == "payload";
-        }
-    );
+    // Either a full binary in "payload", or a zstd --patch-from delta in "patch" against the installed binary
+    const server::multipart_element* payload = find_element(req, "payload");
+    const server::multipart_element* patch = find_element(req, "patch");
 
-    if (payload == req.multipart_body->elements.end()) {
+    if (!payload && !patch) {
         std::cout << "Missing payload\n";
         req.respond(server::response(400, "Bad Request", "text/plain"));
         req.terminate();
         return;
     }
 
+    if (payload && patch) {
+        std::cout << "Both payload and patch supplied\n";
+        req.respond(server::response(400, "Bad Request", "text/plain"));
+        req.terminate();
+        return;
+    }
+
+    std::optional<server::content_encoding> encoding = server::parse_content_encoding((payload ? payload : patch)->content_encoding);
+    // A patch is always a zstd frame, so it may only be labelled as such (or not labelled at all)
+    if (patch && encoding == server::content_encoding::IDENTITY) {
+        encoding = server::content_encoding::ZSTD;
+    }
+
+    if (!encoding || (patch && encoding != server::content_encoding::ZSTD)) {
+        std::cout << "Unsupported " << (payload ? "payload" : "patch") << " encoding\n";
+        req.respond(server::response(415, "Unsupported Media Type", "text/plain"));
+        req.terminate();
+        return;
+    }
+
+    // Patches are only applied if the client diffed against exactly what's installed; a 409 tells it to send the full binary instead
+    std::vector<uint8_t> base;
+    if (!payload) {
+        const server::multipart_element* base_digest = find_element(req, "base_sha256");
+        if (!base_digest) {
+            std::cout << "Missing base digest for patch\n";
+            req.respond(server::response(400, "Bad Request", "text/plain"));
+            req.terminate();
+            return;
+        }
+
+        if (!util::read_file(install_path, base) || util::sha256_hex(base) != normalize_digest(base_digest->data)) {
+            std::cout << "Patch base does not match installed binary\n";
+            req.respond(server::response(409, "Base Mismatch", "text/plain"));
+            req.terminate();
+            return;
+        }
+    }
+
     const std::string temp_path = "/tmp/hildabot_pending";
     std::ofstream temp_file(temp_path, std::ios::trunc | std::ios::binary | std::ios::out);
     if (!temp_file.is_open()) {
@@ -59,8 +152,45 @@ void deploy::verify_and_deploy(server::request& req) {
         return;
     }
 
-    temp_file.write(reinterpret_cast<const char*>(payload->data.data()), payload->data.size());
+    // The encoded part is already buffered by the multipart parser; decode it into the staging file in one
+    // pass so the decompressed binary is never held in memory
+    try {
+        const server::multipart_element* source = payload ? payload : patch;
+        server::decompressor decoder(*encoding, max_payload_size);
+        if (!payload) {
+            decoder.set_prefix(base);
+        }
+
+        decoder.update(source->data.data(), source->data.size(), [&temp_file](const uint8_t* data, size_t size) {
+            temp_file.write(reinterpret_cast<const char*>(data), size);
+        });
+        decoder.finish();
+    }
+    catch (const std::length_error& e) {
+        std::cout << "Decompressed payload too large\n";
+        temp_file.close();
+        std::filesystem::remove(temp_path);
+        req.respond(server::response(413, "Payload Too Large", "text/plain"));
+        req.terminate();
+        return;
+    }
+    catch (const std::exception& e) {
+        std::cout << "Failed to decode " << (payload ? "payload" : "patch") << ": " << e.what() << '\n';
+        temp_file.close();
+        std::filesystem::remove(temp_path);
+        req.respond(server::response(400, "Bad Request", "text/plain"));
+        req.terminate();
+        return;
+    }
+
     temp_file.close();
+    if (!temp_file) {
+        std::cout << "Failed to write temp file\n";
+        std::filesystem::remove(temp_path);
+        req.respond(server::response(500, "Internal Server Error", "text/plain"));
+        req.terminate();
+        return;
+    }
 
     const std::string command = "/usr/bin/gh attestation verify " + temp_path + " --repo Solarphlare/Hildabot";
     const int exit_code = std::system(command.c_str());
@@ -73,13 +203,72 @@ void deploy::verify_and_deploy(server::request& req) {
         return;
     }
 
-    std::system("/usr/bin/sudo /usr/bin/systemctl stop hildabot.service");
-    // EXDEV with rename, so copy + remove
-    std::filesystem::copy(temp_path, "/home/willi/bin/hildabot/hildabot", std::filesystem::copy_options::overwrite_existing);
+    std::unique_lock<std::mutex> lock(install_mutex);
+
+    // Keep the verified binary around so it can be rolled back to without another upload
+    if (!retain_artifact(temp_path)) {
+        std::cout << "Failed to retain artifact\n";
+    }
+
+    const bool installed = install(temp_path);
+    lock.unlock();
     std::filesystem::remove(temp_path);
-    chmod("/home/willi/bin/hildabot/hildabot", S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
-    std::system("/usr/bin/sudo /usr/bin/systemctl start hildabot.service");
+
+    if (!installed) {
+        req.respond(server::response(500, "Internal Server Error", "text/plain"));
+        req.terminate();
+        return;
+    }
 
     req.respond(server::response(201, "Deployed", "text/plain"));
     req.terminate();
 }
+
+void deploy::rollback(server::request& req) {
+    if (req.method != server::http_method::POST) {
+        std::cout << "Invalid method\n";
+        req.respond(server::response(405, "Method Not Allowed", "text/plain"));
+        req.terminate();
+        return;
+    }
+
+    if (req.headers.find("Authorization") == req.headers.end() || req.headers.at("Authorization") != DEPLOY_KEY) {
+        std::cout << "Invalid or missing authorization\n";
+
+        req.respond(server::response(401, "Unauthorized", "text/plain"));
+        req.terminate();
+        return;
+    }
+
+    // Roll back to the artifact named in "sha256", or to the one deployed before the current binary
+    std::optional<std::string> digest;
+    const server::multipart_element* target = req.multipart_body.has_value() ? find_element(req, "sha256") : nullptr;
+    if (target) {
+        digest = normalize_digest(target->data);
+    }
+
+    std::lock_guard<std::mutex> lock(install_mutex);
+
+    if (!digest) {
+        digest = previous_artifact(util::sha256_file(install_path).value_or(""));
+    }
+
+    std::optional<std::string> artifact = digest ? find_artifact(*digest) : std::nullopt;
+    if (!artifact) {
+        std::cout << "No retained artifact to roll back to\n";
+        req.respond(server::response(404, "Not Found", "text/plain"));
+        req.terminate();
+        return;
+    }
+
+    // Artifacts only enter the store after passing attestation, so there's nothing to re-verify
+    std::cout << "Rolling back to " << *digest << '\n';
+    if (!install(*artifact)) {
+        req.respond(server::response(500, "Internal Server Error", "text/plain"));
+        req.terminate();
+        return;
+    }
+
+    req.respond(server::response(200, "Rolled Back", "text/plain"));
+    req.terminate();
+}
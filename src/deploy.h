@@ -4,4 +4,5 @@
 
 namespace deploy {
     void verify_and_deploy(server::request& req);
+    void rollback(server::request& req);
 }
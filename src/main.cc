@@ -57,14 +57,18 @@ void handle_client(SSL_CTX* ctx, int client_fd, const sockaddr_in6 client_addr)
     inet_ntop(AF_INET6, &client_addr.sin6_addr, client_ip, sizeof(client_ip));
     std::cout << (request.method == server::http_method::POST ? "POST" : "OTHER") << " " << request.path << " from " << client_ip << '\n';
 
-    if (request.path != "/hildabot/deploy") {
-        server::response response(404, "Not Found", "text/plain");
-        request.respond(response);
-        request.terminate();
+    if (request.path == "/hildabot/deploy") {
+        deploy::verify_and_deploy(request);
+        return;
+    }
+    else if (request.path == "/hildabot/rollback") {
+        deploy::rollback(request);
         return;
     }
     else {
-        deploy::verify_and_deploy(request);
+        server::response response(404, "Not Found", "text/plain");
+        request.respond(response);
+        request.terminate();
         return;
     }
 }
@@ -68,6 +68,7 @@ server::multipart_body::multipart_body(std::vector<uint8_t>& body, std::unordere
         std::string name;
         std::optional<std::string> filename = std::nullopt;
         std::string content_type_header = "text/plain";
+        std::string content_encoding_header = "identity";
 
         const uint8_t* line_start = cur;
         while (line_start < hdr_end) {
@@ -102,6 +103,9 @@ server::multipart_body::multipart_body(std::vector<uint8_t>& body, std::unordere
             else if (line.rfind("Content-Type: ", 0) == 0) {
                 content_type_header = line.substr(14);
             }
+            else if (line.rfind("Content-Encoding: ", 0) == 0) {
+                content_encoding_header = line.substr(18);
+            }
 
             line_start = (line_end < hdr_end) ? (line_end + crlf.size()) : hdr_end;
         }
@@ -134,7 +138,7 @@ server::multipart_body::multipart_body(std::vector<uint8_t>& body, std::unordere
         // Store element
         if (!name.empty()) {
             std::vector<uint8_t> data(data_start, data_end);
-            this->elements.emplace_back(std::move(name), std::move(filename), std::move(content_type_header), std::move(data));
+            this->elements.emplace_back(std::move(name), std::move(filename), std::move(content_type_header), std::move(content_encoding_header), std::move(data));
         }
 
         // Advance past boundary line
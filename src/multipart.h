@@ -11,12 +11,14 @@ namespace server {
             std::string name;
             std::optional<std::string> filename;
             std::string content_type;
+            std::string content_encoding;
             std::vector<uint8_t> data;
 
-            multipart_element(std::string&& name, std::optional<std::string>&& filename, std::string&& content_type, std::vector<uint8_t>&& data) :
+            multipart_element(std::string&& name, std::optional<std::string>&& filename, std::string&& content_type, std::string&& content_encoding, std::vector<uint8_t>&& data) :
                 name(std::move(name)),
                 filename(std::move(filename)),
                 content_type(std::move(content_type)),
+                content_encoding(std::move(content_encoding)),
                 data(std::move(data))
             {}
     };
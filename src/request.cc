@@ -15,6 +15,7 @@
 #include <memory>
 #include "response.h"
 #include "multipart.h"
+#include "decompress.h"
 
 server::request::request(SSL_CTX* ctx, const int client_fd) {
     this->ssl = std::unique_ptr<SSL, decltype(&SSL_free)>(SSL_new(ctx), &SSL_free);
@@ -158,6 +159,17 @@ server::request::request(SSL_CTX* ctx, const int client_fd) {
             throw std::runtime_error("Payload too large");
         }
 
+        // Only individual multipart parts may be encoded (see verify_and_deploy); refuse an encoded body
+        // up front rather than letting it fail multipart parsing
+        if (
+            this->headers.find("Content-Encoding") != this->headers.end() &&
+            server::parse_content_encoding(this->headers["Content-Encoding"]) != server::content_encoding::IDENTITY
+        ) {
+            SSL_write(this->ssl.get(), "HTTP/1.1 415 Unsupported Media Type\r\n\r\n", 39);
+            this->terminate();
+            throw std::runtime_error("Unsupported Content-Encoding");
+        }
+
         // Locate header/body split and collect body
         const size_t header_end = static_cast<size_t>(headers_end_ptr - buffer.data());
         const size_t body_start = header_end + 4;
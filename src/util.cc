@@ -0,0 +1,66 @@
+#include "util.h"
+#include <fstream>
+#include <memory>
+#include <openssl/sha.h>
+#include <openssl/evp.h>
+
+bool util::read_file(const std::string& path, std::vector<uint8_t>& out) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    out.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(out.data()), out.size());
+    return static_cast<bool>(file);
+}
+
+static std::string to_hex(const unsigned char* digest, size_t size) {
+    constexpr char hex[] = "0123456789abcdef";
+    std::string result;
+    for (size_t i = 0; i < size; i++) {
+        result += hex[digest[i] >> 4];
+        result += hex[digest[i] & 0xf];
+    }
+
+    return result;
+}
+
+std::string util::sha256_hex(const std::vector<uint8_t>& data) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(data.data(), data.size(), digest);
+    return to_hex(digest, sizeof(digest));
+}
+
+std::optional<std::string> util::sha256_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+    if (!ctx || EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) != 1) {
+        return std::nullopt;
+    }
+
+    std::vector<char> chunk(64 * 1024);
+    while (file) {
+        file.read(chunk.data(), chunk.size());
+        if (file.gcount() > 0 && EVP_DigestUpdate(ctx.get(), chunk.data(), static_cast<size_t>(file.gcount())) != 1) {
+            return std::nullopt;
+        }
+    }
+
+    if (file.bad()) {
+        return std::nullopt;
+    }
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size = 0;
+    if (EVP_DigestFinal_ex(ctx.get(), digest, &digest_size) != 1) {
+        return std::nullopt;
+    }
+
+    return to_hex(digest, digest_size);
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <optional>
+#include <cstdint>
+
+namespace util {
+    bool read_file(const std::string& path, std::vector<uint8_t>& out);
+    // Lowercase hex SHA-256 digest
+    std::string sha256_hex(const std::vector<uint8_t>& data);
+    // Same digest as sha256_hex, computed in fixed-size chunks so the file is never loaded whole
+    std::optional<std::string> sha256_file(const std::string& path);
+}